@@ -1,6 +1,6 @@
 from .bulkhasher import *
 
-__all__ = ["bulkhasher", "hash_file", "get_hash_from_file", "check_hashes_against_file", "regenerate_hashes"]
+__all__ = ["bulkhasher", "Pool", "hash_file", "get_hash_from_file", "check_hashes_against_file", "regenerate_hashes", "merge_manifests", "watch_hashes"]
 
 __version__ = "0.0.2"
 
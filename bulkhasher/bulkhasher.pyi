@@ -30,29 +30,117 @@ def get_hash_from_file(file_to_hash: str, sha_file: str) -> str:
     """
     ...
 
-def check_hashes_against_file(hash_list_filename: str) -> int:
+def check_hashes_against_file(hash_list_filename: str, shard_index: int = 0, shard_count: int = 1) -> int:
     """
     Open the file specified and check all files in the file against re-calculated SHA256 hashes, returns the number of mismatched hashes
 
+    Files that are listed but missing or unreadable count as mismatched hashes
+
+    With shard_count > 1 only the files of shard shard_index are checked, so that several processes or hosts can split the work
+
     Arguments:
         - hash_list_filename: str - File containing SHA256 hashes
+        - shard_index: int - Shard to check, from 0 to shard_count - 1
+        - shard_count: int - Number of shards the files are split into
 
     Returns: int - Number of mismatched hashes
     """
     ...
 
-def regenerate_hashes(path: str, out_file: str) -> None:
+def regenerate_hashes(path: str, out_file: str, shard_index: int = 0, shard_count: int = 1) -> None:
     """
-    Regenerate SHA256 hashes recursively for all files in the directory specified, writing the results to the specified file
+    Regenerate SHA256 hashes recursively for all files in the directory specified, writing the results sorted by filename to the specified file
+
+    With shard_count > 1 only the files of shard shard_index are hashed, files are assigned to shards by a hash of their path.
+    Run one process per shard, then combine their files with merge_manifests
 
     Arguments:
         - path: str - Path to recursively check the files of
         - out_file: str - File to write the hashes of the files to
+        - shard_index: int - Shard to hash, from 0 to shard_count - 1
+        - shard_count: int - Number of shards the files are split into
     
     Returns: None
     """
     ...
 
+def merge_manifests(partial_files: list[str], out_file: str) -> int:
+    """
+    Merge SHA256 files sorted by filename, such as the ones written by each shard of regenerate_hashes, into a single sorted file
+
+    Arguments:
+        - partial_files: list[str] - Files containing sorted SHA256 hashes
+        - out_file: str - File to write the merged hashes to
+
+    Returns: int - Number of hashes written
+    """
+    ...
+
+def watch_hashes(path: str, out_file: str, flush_interval: float = 5.0, duration: float = 0.0) -> int:
+    """
+    Keep the SHA256 hashes of all files in the directory specified up to date in out_file, rehashing files as they are written (Linux only)
+
+    The hashes are seeded from out_file, only files that are missing from it or changed since it was written are hashed.
+    Files are rehashed once writes to them settle, and out_file is atomically replaced at most once per flush_interval.
+    Stops after duration seconds, or on KeyboardInterrupt if duration is 0.
+
+    Arguments:
+        - path: str - Path to recursively watch the files of, as passed to regenerate_hashes
+        - out_file: str - File to read the hashes from and write them to
+        - flush_interval: float - Minimum number of seconds between two writes of out_file
+        - duration: float - Number of seconds to watch for, 0 to watch until interrupted
+
+    Returns: int - Number of files hashed
+    """
+    ...
+
+class Pool:
+    """
+    Hashing workers with I/O buffers and hashing contexts that are allocated once and reused across calls
+
+    The module level functions hash with a default pool of 16 threads, create a Pool to choose the number of threads
+    or to free the buffers with close(). Can be used as a context manager
+    """
+
+    threads: int
+    """Number of threads the pool hashes with"""
+
+    def __init__(self, threads: int = 16) -> None: ...
+
+    def hash_file(self, filename: str) -> str:
+        """Same as bulkhasher.hash_file"""
+        ...
+
+    def hash_files(self, filenames: list[str]) -> list[str | None]:
+        """
+        Hash the contents of the files specified in parallel
+
+        Arguments:
+            - filenames: list[str] - Files to hash
+
+        Returns: list[str | None] - SHA256 hexadecimal representation of hash of each file, None for files that could not be read
+        """
+        ...
+
+    def check_hashes_against_file(self, hash_list_filename: str, shard_index: int = 0, shard_count: int = 1) -> int:
+        """Same as bulkhasher.check_hashes_against_file"""
+        ...
+
+    def regenerate_hashes(self, path: str, out_file: str, shard_index: int = 0, shard_count: int = 1) -> None:
+        """Same as bulkhasher.regenerate_hashes"""
+        ...
+
+    def watch_hashes(self, path: str, out_file: str, flush_interval: float = 5.0, duration: float = 0.0) -> int:
+        """Same as bulkhasher.watch_hashes"""
+        ...
+
+    def close(self) -> None:
+        """Free the buffers of the pool, it can't be used afterwards. Raises RuntimeError while another thread is using the pool"""
+        ...
+
+    def __enter__(self) -> "Pool": ...
+    def __exit__(self, *args) -> None: ...
+
 
 def version() -> str:
     """
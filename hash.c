@@ -2,6 +2,16 @@
 #include <omp.h>
 #include <dirent.h>
 #include <stdbool.h>
+#include <limits.h>
+#include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#endif
 #include "sha2.h"
 
 #include "hash.h"
@@ -9,7 +19,7 @@
 #define CHECK_ALLOC(x, y) \
     if (x == NULL) { PyErr_NoMemory(); return y; }
 
-omp_lock_t lock;
+static HashingPool* default_pool = NULL;
 
 /// @brief Checks if a string ends with another string
 /// @param s String to check
@@ -25,15 +35,11 @@ int strend(const char *s, const char *t) {
     return 0; // t was longer than s
 }
 
-/// @brief Hashes a file in fp and stores the hash in ctx
-/// @param fp File stream to hash
-/// @param ctx Hashing context to write to
-void C_hash_file(FILE *fp, sha256_ctx *ctx) {
-    unsigned char buffer[BUFFER_SIZE];
-    size_t bytes_read = 0;
-    while ((bytes_read = fread(buffer, 1, BUFFER_SIZE, fp)) > 0)
-        sha256_update(ctx, buffer, bytes_read);
-    sha256_final(ctx, ctx->block);
+/// @brief Checks if a file should be left out of the manifest
+/// @param path Path of the file
+/// @return true if the file is skipped, false otherwise
+bool is_excluded_path(const char* path) {
+    return strend(path, ".gitignore") || strend(path, ".git") || strstr(path, "/weights/") != NULL;
 }
 
 /// @brief Converts a SHA256 byte hash to a string
@@ -47,54 +53,161 @@ void convert_hash_to_str(unsigned char* hash, char* hash_str) {
     hash_str[SHA256_DIGEST_SIZE * 2] = '\0';
 }
 
-/// @brief Hashes all files in the HashingDirectory dir
-/// @param dir HashingDirectory to hash
-/// @return Array of hashed files
-char** hash_files(HashingDirectory* dir) {
-    omp_set_num_threads(PARALLEL_PROCESSES);
+/// @brief Hashes an open file with a worker's buffer and stores the hash in ctx
+/// @param fd File descriptor to hash
+/// @param ctx Hashing context to write to
+/// @param buffer Buffer of POOL_BUFFER_SIZE bytes to read into
+/// @return 0 on success, -1 if reading failed
+int C_hash_fd(int fd, sha256_ctx *ctx, unsigned char* buffer) {
+#ifdef POSIX_FADV_SEQUENTIAL
+    // Not available on macOS, where read-ahead is already on by default
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    ssize_t bytes_read;
+    while ((bytes_read = read(fd, buffer, POOL_BUFFER_SIZE)) != 0) {
+        if (bytes_read < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        sha256_update(ctx, buffer, bytes_read);
+    }
+    sha256_final(ctx, ctx->block);
+    return 0;
+}
 
-    char** hashes = calloc(dir->num_files, sizeof(char*));
-    CHECK_ALLOC(hashes, NULL);
+/// @brief Creates a pool of hashing workers, each with its own I/O buffer and hashing context
+/// @param num_threads Number of threads to hash with
+/// @return The pool, NULL on allocation failure
+HashingPool* pool_create(int num_threads) {
+    HashingPool* pool = calloc(1, sizeof(HashingPool));
+    CHECK_ALLOC(pool, NULL);
+    pool->num_threads = num_threads;
+    pool->workers = calloc(num_threads, sizeof(HashingWorker));
+    if (pool->workers == NULL) { free(pool); PyErr_NoMemory(); return NULL; }
 
-    for (size_t i = 0; i < dir->num_files; ++i) {
-        hashes[i] = malloc(SHA256_DIGEST_SIZE * 2 + 1);
-        CHECK_ALLOC(hashes[i], NULL);
+    for (int i = 0; i < num_threads; ++i) {
+        if (posix_memalign((void**)&pool->workers[i].buffer, POOL_BUFFER_ALIGNMENT, POOL_BUFFER_SIZE) != 0) {
+            pool->workers[i].buffer = NULL;
+            pool_destroy(pool);
+            PyErr_NoMemory();
+            return NULL;
+        }
+    }
+    pool->busy = PyThread_allocate_lock();
+    if (pool->busy == NULL) {
+        pool_destroy(pool);
+        PyErr_NoMemory();
+        return NULL;
     }
+    omp_init_lock(&pool->lock);
+    return pool;
+}
 
-    #pragma omp parallel for schedule(dynamic)
-    for (size_t i = 0; i < dir->num_files; ++i) {
-        sha256_ctx ctx;
-        sha256_init(&ctx);
-        FILE* fp = fopen(dir->files[i], "r");
-        if (fp == NULL) {
-            omp_set_lock(&lock);
-                PyErr_SetFromErrno(PyExc_OSError);
-                printf("Error opening file: %s\n", dir->files[i]);
-            omp_unset_lock(&lock);
-            free(hashes[i]); hashes[i] = NULL;
-            continue;
-        }
+void pool_destroy(HashingPool* pool) {
+    if (pool == NULL) return;
+    for (int i = 0; i < pool->num_threads; ++i)
+        free(pool->workers[i].buffer);
+    // The locks are only created once every buffer was allocated
+    if (pool->busy != NULL) {
+        PyThread_free_lock(pool->busy);
+        omp_destroy_lock(&pool->lock);
+    }
+    free(pool->workers);
+    free(pool->results);
+    free(pool);
+}
 
-        C_hash_file(fp, &ctx);
-        convert_hash_to_str(ctx.block, hashes[i]);
+/// @brief Waits until no other call is hashing with the pool. Doesn't need the GIL,
+///        callers that hold it have to release it while waiting
+/// @param pool Pool to take
+void pool_lock(HashingPool* pool) {
+    PyThread_acquire_lock(pool->busy, WAIT_LOCK);
+}
 
-        fclose(fp);
+void pool_unlock(HashingPool* pool) {
+    PyThread_release_lock(pool->busy);
+}
+
+/// @brief Gets the pool the module level functions hash with, creating it on first use
+/// @return The pool, NULL on allocation failure
+HashingPool* get_default_pool(void) {
+    if (default_pool == NULL) default_pool = pool_create(PARALLEL_PROCESSES);
+    return default_pool;
+}
+
+/// @brief Hashes a single file with the first worker of the pool
+/// @param pool Pool to hash with
+/// @param filename File to hash
+/// @param hash_str pointer to a string to store the hash in
+/// @return 0 on success, -1 on error with errno set
+int pool_hash_file(HashingPool* pool, const char* filename, char* hash_str) {
+    HashingWorker* worker = &pool->workers[0];
+    int fd = open(filename, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+
+    sha256_init(&worker->ctx);
+    int status = C_hash_fd(fd, &worker->ctx, worker->buffer);
+    int saved_errno = errno;
+    close(fd);
+    if (status != 0) { errno = saved_errno; return -1; }
+
+    convert_hash_to_str(worker->ctx.block, hash_str);
+    return 0;
+}
+
+/// @brief Hashes all files in the HashingDirectory dir
+/// @param pool Pool to hash with
+/// @param dir HashingDirectory to hash
+/// @return HASH_STR_SIZE bytes per file, an empty string for files that could not be read.
+///         Owned by the pool and valid until its next call, NULL with errno set on allocation failure.
+///         The caller has to hold the pool lock, not the GIL
+const char* hash_files(HashingPool* pool, HashingDirectory* dir) {
+    size_t size = (dir->num_files ? dir->num_files : 1) * HASH_STR_SIZE;
+    if (size > pool->results_capacity) {
+        char* resized = realloc(pool->results, size);
+        if (resized == NULL) { errno = ENOMEM; return NULL; }
+        pool->results = resized;
+        pool->results_capacity = size;
     }
+    char* hashes = pool->results;
 
-    omp_destroy_lock(&lock);
+    // libgomp keeps the threads of a team alive between parallel regions of the same size
+    #pragma omp parallel for schedule(dynamic) num_threads(pool->num_threads)
+    for (size_t i = 0; i < dir->num_files; ++i) {
+        HashingWorker* worker = &pool->workers[omp_get_thread_num()];
+        char* hash_str = &hashes[i * HASH_STR_SIZE];
+        sha256_init(&worker->ctx);
 
+        int fd = open(dir->files[i], O_RDONLY | O_CLOEXEC);
+        if (fd < 0 || C_hash_fd(fd, &worker->ctx, worker->buffer) != 0) {
+            // Worker threads have no Python thread state, so only report the error here
+            omp_set_lock(&pool->lock);
+                fprintf(stderr, "Error %s file: %s: %s\n", fd < 0 ? "opening" : "reading", dir->files[i], strerror(errno));
+            omp_unset_lock(&pool->lock);
+            hash_str[0] = '\0';
+        } else {
+            convert_hash_to_str(worker->ctx.block, hash_str);
+        }
+
+        if (fd >= 0) close(fd);
+    }
 
     return hashes;
 }
 
 // Utility functions for stack operations
-void push(StackNode** top, const char* path) {
+// push doesn't raise, so that get_filenames can run without the GIL. It returns -1 with errno set instead
+int push(StackNode** top, const char* path) {
     StackNode* new_node = malloc(sizeof(StackNode));
-    CHECK_ALLOC(new_node, ;);
+    if (new_node == NULL) return -1;
     new_node->path = strdup(path);
-    CHECK_ALLOC(new_node->path, ;);
+    if (new_node->path == NULL) {
+        free(new_node);
+        return -1;
+    }
     new_node->next = *top;
     *top = new_node;
+    return 0;
 }
 
 char* pop(StackNode** top) {
@@ -116,7 +229,7 @@ void free_stack(StackNode** top) {
 
 /// @brief Gets all filenames recursively from the directory specified
 /// @param root_path Directory to get filenames from
-/// @return HashingDirectory with all the filenames
+/// @return HashingDirectory with all the filenames, NULL with errno set on allocation failure
 HashingDirectory* get_filenames(char* root_path) {
     HashingDirectory* directories = malloc(sizeof(HashingDirectory));
     if (!directories) return NULL;
@@ -129,7 +242,11 @@ HashingDirectory* get_filenames(char* root_path) {
     }
 
     StackNode* stack = NULL;
-    push(&stack, strdup(root_path)); // Duplicate the root_path to be able to free it later
+    if (push(&stack, root_path) != 0) {
+        free(directories->files);
+        free(directories);
+        return NULL;
+    }
 
     while (stack != NULL) {
         char* path = pop(&stack);
@@ -182,8 +299,10 @@ HashingDirectory* get_filenames(char* root_path) {
             } else if (dir->d_type == DT_DIR && strcmp(dir->d_name, ".") != 0 && strcmp(dir->d_name, "..") != 0) {
                 // Push sub-directory to the stack
                 char* sub_path = malloc(strlen(path) + strlen(dir->d_name) + 2);
-                if (!sub_path) {
+                if (sub_path) sprintf(sub_path, "%s/%s", path, dir->d_name);
+                if (!sub_path || push(&stack, sub_path) != 0) {
                     // Handle error: free all resources
+                    free(sub_path);
                     closedir(d);
                     free(path);
                     for (size_t i = 0; i < directories->num_files; ++i) {
@@ -194,8 +313,7 @@ HashingDirectory* get_filenames(char* root_path) {
                     free_stack(&stack);
                     return NULL;
                 }
-                sprintf(sub_path, "%s/%s", path, dir->d_name);
-                push(&stack, sub_path);
+                free(sub_path);
             }
         }
 
@@ -207,99 +325,120 @@ HashingDirectory* get_filenames(char* root_path) {
     return directories;
 }
 
-/// @brief Regenerates SHA256 hashes for all files in the directory specified
+/// @brief Regenerates SHA256 hashes for the files of one shard of the directory specified
+/// @param pool Pool to hash with
 /// @param path Directory to get filenames from
-/// @param out_file File to write the hashes to
-void C_regenerate_hashes(char* path, char* out_file) {
-    omp_set_num_threads(PARALLEL_PROCESSES);
-
+/// @param out_file File to write the hashes to, sorted by filename
+/// @param shard_index Shard to hash, from 0 to shard_count - 1
+/// @param shard_count Number of shards the files are split into, 1 to hash all of them
+/// @return 0 on success, -1 on error with errno set. Doesn't touch Python, so it can run without the GIL
+int C_regenerate_hashes(HashingPool* pool, char* path, char* out_file, size_t shard_index, size_t shard_count) {
+    // Anything written after the walk started might not be reflected in its hash
+    struct timespec stamp = file_clock_now();
     HashingDirectory* files = get_filenames(path);
-    char** hashes = hash_files(files);
+    if (files == NULL) return -1;
 
-    FILE* fp = fopen(out_file, "w");
-    if (fp == NULL) {
-        PyErr_SetFromErrno(PyExc_OSError);
-        fprintf(stderr, "Error opening file: %s\n", strerror(errno));
-        return;
-    }
-
-    #pragma omp parallel for schedule(dynamic)
+    // Only hash the files that belong to this shard
+    size_t kept = 0;
     for (size_t i = 0; i < files->num_files; ++i) {
-        if (!(strend(files->files[i], ".gitignore")) && !(strend(files->files[i], ".git")) && strstr(files->files[i], "/weights/") == NULL)
-            fprintf(fp, "%s = %s\n", files->files[i], hashes[i]);
+        if (is_excluded_path(files->files[i]) || shard_of_path(files->files[i], shard_count) != shard_index)
+            free(files->files[i]);
+        else
+            files->files[kept++] = files->files[i];
     }
+    files->num_files = kept;
+
+    const char* hashes = hash_files(pool, files);
+    int status = hashes ? 0 : -1;
+
+    Manifest manifest = { .num_entries = 0, .capacity = files->num_files, .entries = malloc(sizeof(ManifestEntry) * (files->num_files + 1)) };
+    if (status == 0 && manifest.entries == NULL) { errno = ENOMEM; status = -1; }
 
     for (size_t i = 0; i < files->num_files; ++i) {
-        free(files->files[i]);
-        free(hashes[i]);
+        if (status == 0 && hashes[i * HASH_STR_SIZE] != '\0') {
+            manifest.entries[manifest.num_entries].path = files->files[i];
+            memcpy(manifest.entries[manifest.num_entries++].hash, &hashes[i * HASH_STR_SIZE], HASH_STR_SIZE);
+        } else {
+            free(files->files[i]);
+        }
     }
 
-    fclose(fp);
+    // Sorted output is what lets partial manifests of several shards be merged
+    qsort(manifest.entries, manifest.num_entries, sizeof(ManifestEntry), compare_manifest_entries);
+    if (status == 0) status = manifest_flush(&manifest, out_file, stamp);
 
+    int saved_errno = errno;
+    manifest_free(&manifest);
     free(files->files);
     free(files);
-    free(hashes);
+    errno = saved_errno;
+    return status;
 }
 
-/// @brief Checks the SHA256 hashes against the file specified in the line
-/// @param line Line of the file
+/// @brief Checks the SHA256 hashes of one shard against the file specified
+/// @param pool Pool to hash with
+/// @param hash_list_filename File containing SHA256 hashes
+/// @param shard_index Shard to check, from 0 to shard_count - 1
+/// @param shard_count Number of shards the files are split into, 1 to check all of them
 /// @return Number of mismatched hashes
-size_t process_line_of_SHA256_file(char* line) {
-    sha256_ctx ctx;
-    sha256_init(&ctx);
-
-    size_t mismatched_hashes = 0;
-    
-    // Remove newline character, if present
-    char* newline = strchr(line, '\n');
-    if (newline) *newline = '\0';
-
-    // Parse the line to extract filename and stored hash
-    char* filename = strtok(line, " = ");
-    char* stored_hash = strtok(NULL, " = ");
+size_t C_check_hashes_against_file(HashingPool* pool, const char* hash_list_filename, size_t shard_index, size_t shard_count) {
+    FILE* file = fopen(hash_list_filename, "r");
+    if (file == NULL) { PyErr_SetFromErrnoWithFilename(PyExc_OSError, hash_list_filename); return -1; }
 
-    if (filename && stored_hash) {
-        FILE* fp = fopen(filename, "r");
-        if (fp == NULL) { PyErr_SetFromErrno(PyExc_OSError); printf("Error opening file: %s\n", filename); return 0; }
+    HashingDirectory files = { .num_files = 0, .files = NULL };
+    char* stored_hashes = NULL;
+    size_t capacity = 0;
+    size_t mismatched_hashes = -1;
 
-        C_hash_file(fp, &ctx);
+    // Read the whole shard first so it can be hashed in parallel
+    char line[READ_BUFFER];
+    while (fgets(line, READ_BUFFER, file) != NULL) {
+        char* filename; char* stored_hash;
+        if (!split_manifest_line(line, &filename, &stored_hash) || shard_of_path(filename, shard_count) != shard_index)
+            continue;
 
-        if (ferror(fp)) {
-            printf("Error reading file: %s\n", filename);
-            fclose(fp);
-            return 0;
+        if (files.num_files >= capacity) {
+            capacity = capacity ? capacity * 2 : FILES_TO_STORE;
+            char** resized_files = realloc(files.files, sizeof(char*) * capacity);
+            if (resized_files) files.files = resized_files;
+            char* resized_hashes = realloc(stored_hashes, HASH_STR_SIZE * capacity);
+            if (resized_hashes) stored_hashes = resized_hashes;
+            if (!resized_files || !resized_hashes) { PyErr_NoMemory(); goto cleanup; }
         }
+        files.files[files.num_files] = strdup(filename);
+        if (files.files[files.num_files] == NULL) { PyErr_NoMemory(); goto cleanup; }
 
-        fclose(fp);
+        // A hash of the wrong length can never match
+        char* stored = &stored_hashes[files.num_files * HASH_STR_SIZE];
+        if (strlen(stored_hash) == HASH_STR_SIZE - 1) memcpy(stored, stored_hash, HASH_STR_SIZE);
+        else stored[0] = '\0';
+        files.num_files++;
+    }
 
-        char computed_hash[SHA256_DIGEST_SIZE * 2 + 1];
-        convert_hash_to_str(ctx.block, computed_hash);
+    const char* hashes;
+    Py_BEGIN_ALLOW_THREADS
+        pool_lock(pool);
+        hashes = hash_files(pool, &files);
+    Py_END_ALLOW_THREADS
+    if (hashes == NULL) { pool_unlock(pool); PyErr_NoMemory(); goto cleanup; }
 
-        // Compare the computed hash with the stored hash
-        if ((strcmp(computed_hash, stored_hash) != 0)) {
+    mismatched_hashes = 0;
+    for (size_t i = 0; i < files.num_files; ++i) {
+        const char* computed_hash = &hashes[i * HASH_STR_SIZE];
+        // A file that is missing or can't be read fails verification like a changed one
+        if (computed_hash[0] == '\0' || strcmp(computed_hash, &stored_hashes[i * HASH_STR_SIZE]) != 0) {
             mismatched_hashes++;
-            printf("Hash mismatch: %s\n", filename);
+            printf("Hash mismatch: %s\n", files.files[i]);
         }
     }
+    pool_unlock(pool);
 
-    return mismatched_hashes;
-}
-
-/// @brief Checks all SHA256 hashes against the file specified
-/// @param hash_list_filename File containing SHA256 hashes
-/// @return Number of mismatched hashes
-size_t C_check_hashes_against_file(const char* hash_list_filename) {
-    size_t mismatched_hashes = 0;
-
-    FILE* file = fopen(hash_list_filename, "r");
-    if (file == NULL) { PyErr_SetFromErrno(PyExc_OSError); return -1; }
-
-    char line[READ_BUFFER];
-    while (fgets(line, READ_BUFFER, file) != NULL)
-        mismatched_hashes += process_line_of_SHA256_file(line);
-
+cleanup:
     fclose(file);
-
+    for (size_t i = 0; i < files.num_files; ++i)
+        free(files.files[i]);
+    free(files.files);
+    free(stored_hashes);
     return mismatched_hashes;
 }
 
@@ -327,56 +466,1121 @@ char* C_get_hash_from_file(char* file_to_hash, char* sha_file) {
     return NULL;
 }
 
+// Manifest index
+/// @brief Splits a line of a SHA256 file into the filename and the stored hash, in place
+/// @param line Line of the file
+/// @param filename pointer to store the filename in
+/// @param stored_hash pointer to store the hash in
+/// @return 1 if the line holds a filename and a hash, 0 otherwise
+int split_manifest_line(char* line, char** filename, char** stored_hash) {
+    char* newline = strchr(line, '\n');
+    if (newline) *newline = '\0';
+
+    // Hashes never contain the separator, so split on its last occurrence
+    char* separator = NULL;
+    for (char* p = strstr(line, MANIFEST_SEPARATOR); p != NULL; p = strstr(p + 1, MANIFEST_SEPARATOR))
+        separator = p;
+    if (separator == NULL || separator == line) return 0;
+
+    *separator = '\0';
+    *filename = line;
+    *stored_hash = separator + strlen(MANIFEST_SEPARATOR);
+    return 1;
+}
+
+int compare_manifest_entries(const void* a, const void* b) {
+    return strcmp(((const ManifestEntry*)a)->path, ((const ManifestEntry*)b)->path);
+}
+
+/// @brief Looks a path up in the manifest
+/// @param manifest Sorted manifest to search
+/// @param path Path to look for
+/// @param pos pointer to store the index of the path, or where it would be inserted
+/// @return 1 if the path is in the manifest, 0 otherwise
+int manifest_find(const Manifest* manifest, const char* path, size_t* pos) {
+    size_t lo = 0, hi = manifest->num_entries;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        int cmp = strcmp(manifest->entries[mid].path, path);
+        if (cmp == 0) { *pos = mid; return 1; }
+        if (cmp < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    *pos = lo;
+    return 0;
+}
+
+/// @brief Makes room for one more entry at pos
+/// @param manifest Manifest to grow
+/// @param pos Index the new entry goes to
+/// @return Pointer to the new entry, NULL on allocation failure
+ManifestEntry* manifest_insert_at(Manifest* manifest, size_t pos) {
+    if (manifest->num_entries >= manifest->capacity) {
+        size_t capacity = manifest->capacity ? manifest->capacity * 2 : FILES_TO_STORE;
+        ManifestEntry* resized = realloc(manifest->entries, sizeof(ManifestEntry) * capacity);
+        CHECK_ALLOC(resized, NULL);
+        manifest->entries = resized;
+        manifest->capacity = capacity;
+    }
+    memmove(&manifest->entries[pos + 1], &manifest->entries[pos], sizeof(ManifestEntry) * (manifest->num_entries - pos));
+    manifest->num_entries++;
+    return &manifest->entries[pos];
+}
+
+/// @brief Stores the hash of a path, keeping the manifest sorted
+/// @param manifest Manifest to update
+/// @param path Path of the file
+/// @param hash Hexadecimal SHA256 hash of the file
+/// @return 0 on success, -1 on allocation failure
+int manifest_set(Manifest* manifest, const char* path, const char* hash) {
+    size_t pos;
+    if (!manifest_find(manifest, path, &pos)) {
+        char* path_copy = strdup(path);
+        CHECK_ALLOC(path_copy, -1);
+        ManifestEntry* entry = manifest_insert_at(manifest, pos);
+        if (entry == NULL) { free(path_copy); return -1; }
+        entry->path = path_copy;
+    }
+    memcpy(manifest->entries[pos].hash, hash, HASH_STR_SIZE);
+    return 0;
+}
+
+/// @brief Removes a path from the manifest
+/// @param manifest Manifest to update
+/// @param path Path to remove
+/// @return 1 if the path was in the manifest, 0 otherwise
+int manifest_remove(Manifest* manifest, const char* path) {
+    size_t pos;
+    if (!manifest_find(manifest, path, &pos)) return 0;
+    free(manifest->entries[pos].path);
+    memmove(&manifest->entries[pos], &manifest->entries[pos + 1], sizeof(ManifestEntry) * (manifest->num_entries - pos - 1));
+    manifest->num_entries--;
+    return 1;
+}
+
+/// @brief Removes every path inside a directory from the manifest
+/// @param manifest Manifest to update
+/// @param dir Directory to remove
+/// @return Number of removed paths, -1 on allocation failure
+ssize_t manifest_remove_dir(Manifest* manifest, const char* dir) {
+    size_t prefix_len = strlen(dir) + 1;
+    char* prefix = malloc(prefix_len + 1);
+    CHECK_ALLOC(prefix, -1);
+    sprintf(prefix, "%s/", dir);
+
+    // Everything starting with the prefix sorts right after it
+    size_t start, end;
+    manifest_find(manifest, prefix, &start);
+    for (end = start; end < manifest->num_entries && strncmp(manifest->entries[end].path, prefix, prefix_len) == 0; ++end)
+        free(manifest->entries[end].path);
+    free(prefix);
+
+    memmove(&manifest->entries[start], &manifest->entries[end], sizeof(ManifestEntry) * (manifest->num_entries - end));
+    manifest->num_entries -= end - start;
+    return end - start;
+}
+
+void manifest_free(Manifest* manifest) {
+    for (size_t i = 0; i < manifest->num_entries; ++i)
+        free(manifest->entries[i].path);
+    free(manifest->entries);
+    manifest->entries = NULL;
+    manifest->num_entries = manifest->capacity = 0;
+}
+
+/// @brief Reads a SHA256 file into a sorted manifest
+/// @param manifest Empty manifest to fill
+/// @param filename SHA256 file to read
+/// @return 0 on success, -1 on error
+int manifest_load(Manifest* manifest, const char* filename) {
+    FILE* fp = fopen(filename, "r");
+    if (fp == NULL) { PyErr_SetFromErrnoWithFilename(PyExc_OSError, filename); return -1; }
+
+    char line[READ_BUFFER];
+    while (fgets(line, READ_BUFFER, fp) != NULL) {
+        char* path; char* hash;
+        if (!split_manifest_line(line, &path, &hash) || strlen(hash) != HASH_STR_SIZE - 1) continue;
+
+        char* path_copy = strdup(path);
+        ManifestEntry* entry = path_copy ? manifest_insert_at(manifest, manifest->num_entries) : NULL;
+        if (entry == NULL) { free(path_copy); fclose(fp); PyErr_NoMemory(); return -1; }
+        entry->path = path_copy;
+        memcpy(entry->hash, hash, HASH_STR_SIZE);
+    }
+    fclose(fp);
+
+    // Older manifests are written in no particular order
+    qsort(manifest->entries, manifest->num_entries, sizeof(ManifestEntry), compare_manifest_entries);
+    size_t kept = 0;
+    for (size_t i = 0; i < manifest->num_entries; ++i) {
+        if (kept > 0 && strcmp(manifest->entries[kept - 1].path, manifest->entries[i].path) == 0) {
+            free(manifest->entries[kept - 1].path);
+            kept--;
+        }
+        manifest->entries[kept++] = manifest->entries[i];
+    }
+    manifest->num_entries = kept;
+    return 0;
+}
+
+/// @brief Gets the wall-clock time from the clock the kernel stamps files with
+struct timespec file_clock_now(void) {
+    struct timespec ts;
+#ifdef CLOCK_REALTIME_COARSE
+    clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+#else
+    clock_gettime(CLOCK_REALTIME, &ts);
+#endif
+    return ts;
+}
+
+/// @brief Compares two timestamps with nanosecond precision
+/// @return true if a is strictly before b
+bool timespec_before(struct timespec a, struct timespec b) {
+    return a.tv_sec < b.tv_sec || (a.tv_sec == b.tv_sec && a.tv_nsec < b.tv_nsec);
+}
+
+struct timespec stat_mtime(const struct stat* st) {
+#ifdef __APPLE__
+    return st->st_mtimespec;
+#else
+    return st->st_mtim;
+#endif
+}
+
+/// @brief Opens the temporary file a new version of out_file is written to
+/// @param out_file File that is going to be replaced
+/// @param tmp_file pointer to store the name of the temporary file in, freed by manifest_commit
+/// @return File stream to write the hashes to, NULL with errno set on error
+FILE* manifest_begin(const char* out_file, char** tmp_file) {
+    *tmp_file = malloc(strlen(out_file) + strlen(MANIFEST_TMP_SUFFIX) + 1);
+    if (*tmp_file == NULL) { errno = ENOMEM; return NULL; }
+    sprintf(*tmp_file, "%s%s", out_file, MANIFEST_TMP_SUFFIX);
+
+    FILE* fp = fopen(*tmp_file, "w");
+    if (fp == NULL) { int saved_errno = errno; free(*tmp_file); errno = saved_errno; }
+    return fp;
+}
+
+/// @brief Atomically replaces out_file with the temporary file opened by manifest_begin
+/// @param fp File stream returned by manifest_begin
+/// @param tmp_file Name of the temporary file
+/// @param out_file File to replace
+/// @param stamp Time the hashes are known to be current at, stored as the mtime of out_file
+/// @return 0 on success, -1 with errno set on error
+int manifest_commit(FILE* fp, char* tmp_file, const char* out_file, struct timespec stamp) {
+    // Watch mode trusts hashes of files older than the manifest, so its mtime can't be the time of the write
+    struct timespec times[2] = { { .tv_nsec = UTIME_OMIT }, stamp };
+
+    // The data has to be on disk before the rename, or a crash could leave an empty manifest behind
+    if (fflush(fp) != 0 || futimens(fileno(fp), times) != 0 || fsync(fileno(fp)) != 0 || ferror(fp)) {
+        int saved_errno = errno ? errno : EIO;
+        fclose(fp); unlink(tmp_file); free(tmp_file);
+        errno = saved_errno;
+        return -1;
+    }
+    fclose(fp);
+
+    if (rename(tmp_file, out_file) != 0) {
+        int saved_errno = errno;
+        unlink(tmp_file); free(tmp_file);
+        errno = saved_errno;
+        return -1;
+    }
+    free(tmp_file);
+    return 0;
+}
+
+/// @brief Atomically replaces out_file with the contents of the manifest
+/// @param manifest Manifest to write
+/// @param out_file File to write the hashes to
+/// @param stamp Time the hashes are known to be current at, see manifest_commit
+/// @return 0 on success, -1 with errno set on error
+int manifest_flush(const Manifest* manifest, const char* out_file, struct timespec stamp) {
+    char* tmp_file;
+    FILE* fp = manifest_begin(out_file, &tmp_file);
+    if (fp == NULL) return -1;
+
+    for (size_t i = 0; i < manifest->num_entries; ++i)
+        fprintf(fp, "%s" MANIFEST_SEPARATOR "%s\n", manifest->entries[i].path, manifest->entries[i].hash);
+
+    return manifest_commit(fp, tmp_file, out_file, stamp);
+}
+// --------------------------------------
+
+/// @brief Picks the shard a file belongs to, the same way on every host
+/// @param path Path of the file, as written to the SHA256 file
+/// @param shard_count Number of shards
+/// @return Index of the shard
+size_t shard_of_path(const char* path, size_t shard_count) {
+    // 64-bit FNV-1a
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (const unsigned char* p = (const unsigned char*)path; *p; ++p) {
+        h ^= *p;
+        h *= 0x100000001b3ULL;
+    }
+    return h % shard_count;
+}
+
+// K-way merge of sorted SHA256 files
+/// @brief Reads the next hash of a partial manifest
+/// @param cursor Cursor of the partial manifest
+/// @return 1 if a hash was read, 0 at the end of the file
+int merge_cursor_advance(MergeCursor* cursor) {
+    while (fgets(cursor->line, READ_BUFFER, cursor->fp) != NULL) {
+        if (split_manifest_line(cursor->line, &cursor->path, &cursor->hash) && strlen(cursor->hash) == HASH_STR_SIZE - 1)
+            return 1;
+    }
+    return 0;
+}
+
+bool merge_cursor_less(const MergeCursor* a, const MergeCursor* b) {
+    int cmp = strcmp(a->path, b->path);
+    // Ties go to the partial manifest listed first, so merging is deterministic
+    return cmp < 0 || (cmp == 0 && a->index < b->index);
+}
+
+void merge_heap_sift_down(MergeCursor** heap, size_t heap_size, size_t i) {
+    while (true) {
+        size_t smallest = i, left = 2 * i + 1, right = 2 * i + 2;
+        if (left < heap_size && merge_cursor_less(heap[left], heap[smallest])) smallest = left;
+        if (right < heap_size && merge_cursor_less(heap[right], heap[smallest])) smallest = right;
+        if (smallest == i) return;
+        MergeCursor* tmp = heap[i]; heap[i] = heap[smallest]; heap[smallest] = tmp;
+        i = smallest;
+    }
+}
+
+void merge_heap_push(MergeCursor** heap, size_t* heap_size, MergeCursor* cursor) {
+    size_t i = (*heap_size)++;
+    heap[i] = cursor;
+    while (i > 0 && merge_cursor_less(heap[i], heap[(i - 1) / 2])) {
+        MergeCursor* tmp = heap[i]; heap[i] = heap[(i - 1) / 2]; heap[(i - 1) / 2] = tmp;
+        i = (i - 1) / 2;
+    }
+}
+// --------------------------------------
+
+/// @brief Merges sorted SHA256 files into a single sorted SHA256 file
+/// @param partial_files SHA256 files to merge, such as the ones written by the shards of a directory
+/// @param num_partial_files Number of SHA256 files to merge
+/// @param out_file File to write the hashes to
+/// @param failed_file Set on error to the index of the partial file at fault, num_partial_files for out_file
+/// @return Number of hashes written, -1 on error with errno set, -2 if a partial file isn't sorted.
+///         Doesn't touch Python, so it can run without the GIL
+ssize_t C_merge_manifests(char** partial_files, size_t num_partial_files, const char* out_file, size_t* failed_file) {
+    *failed_file = num_partial_files;
+    MergeCursor* cursors = calloc(num_partial_files, sizeof(MergeCursor));
+    MergeCursor** heap = malloc(sizeof(MergeCursor*) * (num_partial_files + 1));
+    char* last_path = malloc(READ_BUFFER);
+    if (cursors == NULL || heap == NULL || last_path == NULL) {
+        free(cursors); free(heap); free(last_path);
+        errno = ENOMEM;
+        return -1;
+    }
+    last_path[0] = '\0';
+
+    ssize_t written = -1;
+    size_t heap_size = 0;
+    char* tmp_file = NULL;
+    FILE* out = NULL;
+    struct timespec stamp = file_clock_now();
+
+    for (size_t i = 0; i < num_partial_files; ++i) {
+        cursors[i].index = i;
+        cursors[i].fp = fopen(partial_files[i], "r");
+        if (cursors[i].fp == NULL) { *failed_file = i; goto cleanup; }
+
+        // The merged hashes are only as current as the oldest partial manifest
+        struct stat st;
+        if (fstat(fileno(cursors[i].fp), &st) == 0 && timespec_before(stat_mtime(&st), stamp)) stamp = stat_mtime(&st);
+        if (merge_cursor_advance(&cursors[i])) merge_heap_push(heap, &heap_size, &cursors[i]);
+    }
+
+    out = manifest_begin(out_file, &tmp_file);
+    if (out == NULL) goto cleanup;
+
+    written = 0;
+    while (heap_size > 0) {
+        MergeCursor* top = heap[0];
+
+        // Shards never overlap, but the same file in two partial manifests is only written once
+        int cmp = strcmp(top->path, last_path);
+        if (cmp < 0) {
+            *failed_file = top->index;
+            fclose(out); unlink(tmp_file); free(tmp_file);
+            written = -2;
+            goto cleanup;
+        }
+        if (cmp > 0 || written == 0) {
+            fprintf(out, "%s" MANIFEST_SEPARATOR "%s\n", top->path, top->hash);
+            strcpy(last_path, top->path);
+            written++;
+        }
+
+        if (merge_cursor_advance(top)) merge_heap_sift_down(heap, heap_size, 0);
+        else { heap[0] = heap[--heap_size]; merge_heap_sift_down(heap, heap_size, 0); }
+    }
+
+    if (manifest_commit(out, tmp_file, out_file, stamp) != 0) written = -1;
+
+cleanup:;
+    int saved_errno = errno;
+    for (size_t i = 0; i < num_partial_files; ++i)
+        if (cursors[i].fp) fclose(cursors[i].fp);
+    free(cursors);
+    free(heap);
+    free(last_path);
+    errno = saved_errno;
+    return written;
+}
+
+#ifdef __linux__
+// Watch mode
+double monotonic_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/// @brief Checks if a path is the manifest the watcher writes to, or its temporary file
+/// @param w Watcher
+/// @param path Path to check
+/// @return true if the watcher wrote the file itself
+bool watcher_is_manifest(const HashWatcher* w, const char* path) {
+    const char* slash = strrchr(path, '/');
+    const char* name = slash ? slash + 1 : path;
+    size_t name_len = strlen(w->manifest_name);
+
+    // Only resolve the directory when the name matches, as that is rare
+    if (strncmp(name, w->manifest_name, name_len) != 0) return false;
+    if (name[name_len] != '\0' && strcmp(name + name_len, MANIFEST_TMP_SUFFIX) != 0) return false;
+
+    char dir[PATH_MAX];
+    char resolved[PATH_MAX];
+    snprintf(dir, sizeof(dir), "%.*s", slash ? (int)(slash - path) : 1, slash ? path : ".");
+    if (realpath(dir, resolved) == NULL) return false;
+    return strcmp(resolved, w->manifest_dir) == 0;
+}
+
+/// @brief Looks a path up in the files waiting to be rehashed, which are kept sorted by path
+/// @param w Watcher
+/// @param path Path to look for
+/// @param pos pointer to store the index of the path, or where it would be inserted
+/// @return 1 if the path is scheduled, 0 otherwise
+int watcher_find_pending(const HashWatcher* w, const char* path, size_t* pos) {
+    size_t lo = 0, hi = w->num_pending;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        int cmp = strcmp(w->pending[mid].path, path);
+        if (cmp == 0) { *pos = mid; return 1; }
+        if (cmp < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    *pos = lo;
+    return 0;
+}
+
+int compare_pending_files(const void* a, const void* b) {
+    return strcmp(((const PendingFile*)a)->path, ((const PendingFile*)b)->path);
+}
+
+/// @brief Adds a file at pos of the scheduled files, without checking the order
+/// @param w Watcher
+/// @param pos Index the file goes to
+/// @param path Path of the file
+/// @param due Time at which to rehash the file
+/// @return 0 on success, -1 on allocation failure
+int watcher_insert_pending(HashWatcher* w, size_t pos, const char* path, double due) {
+    if (w->num_pending >= w->pending_capacity) {
+        size_t capacity = w->pending_capacity ? w->pending_capacity * 2 : FILES_TO_STORE;
+        PendingFile* resized = realloc(w->pending, sizeof(PendingFile) * capacity);
+        CHECK_ALLOC(resized, -1);
+        w->pending = resized;
+        w->pending_capacity = capacity;
+    }
+    char* path_copy = strdup(path);
+    CHECK_ALLOC(path_copy, -1);
+    memmove(&w->pending[pos + 1], &w->pending[pos], sizeof(PendingFile) * (w->num_pending - pos));
+    w->pending[pos].path = path_copy;
+    w->pending[pos].due = due;
+    w->num_pending++;
+    return 0;
+}
+
+/// @brief Sorts the scheduled files again after a walk appended to them, keeping the latest deadline of duplicates
+/// @param w Watcher
+void watcher_sort_pending(HashWatcher* w) {
+    qsort(w->pending, w->num_pending, sizeof(PendingFile), compare_pending_files);
+    size_t kept = 0;
+    for (size_t i = 0; i < w->num_pending; ++i) {
+        if (kept > 0 && strcmp(w->pending[kept - 1].path, w->pending[i].path) == 0) {
+            if (w->pending[i].due > w->pending[kept - 1].due) w->pending[kept - 1].due = w->pending[i].due;
+            free(w->pending[i].path);
+        } else {
+            w->pending[kept++] = w->pending[i];
+        }
+    }
+    w->num_pending = kept;
+}
+
+/// @brief Schedules a file to be rehashed, pushing the deadline back if it is already scheduled
+/// @param w Watcher
+/// @param path Path of the file
+/// @param due Time at which to rehash the file
+/// @return 0 on success, -1 on allocation failure
+int watcher_queue(HashWatcher* w, const char* path, double due) {
+    size_t pos;
+    if (watcher_find_pending(w, path, &pos)) {
+        w->pending[pos].due = due;
+        return 0;
+    }
+    return watcher_insert_pending(w, pos, path, due);
+}
+
+/// @brief Cancels the rehash of a file, or of every file inside a directory
+/// @param w Watcher
+/// @param path Path of the file or directory
+/// @param is_dir Whether path is a directory
+void watcher_unqueue(HashWatcher* w, const char* path, bool is_dir) {
+    size_t len = strlen(path);
+    size_t kept = 0;
+    for (size_t i = 0; i < w->num_pending; ++i) {
+        const char* pending = w->pending[i].path;
+        bool matches = is_dir ? (strncmp(pending, path, len) == 0 && pending[len] == '/') : strcmp(pending, path) == 0;
+        if (matches) free(w->pending[i].path);
+        else w->pending[kept++] = w->pending[i];
+    }
+    w->num_pending = kept;
+}
+
+/// @brief Schedules every file below a directory to be rehashed
+/// @param w Watcher
+/// @param root_path Directory to walk
+/// @param due Time at which to rehash the files
+/// @return 0 on success, -1 on allocation failure
+int watcher_queue_tree(HashWatcher* w, const char* root_path, double due) {
+    HashingDirectory* files = get_filenames((char*)root_path);
+    CHECK_ALLOC(files, -1);
+
+    // Walked paths are unique, so append them all and sort once instead of looking each one up
+    int status = 0;
+    for (size_t i = 0; i < files->num_files; ++i) {
+        if (status == 0 && !is_excluded_path(files->files[i]) && !watcher_is_manifest(w, files->files[i]))
+            status = watcher_insert_pending(w, w->num_pending, files->files[i], due);
+        free(files->files[i]);
+    }
+    free(files->files);
+    free(files);
+    watcher_sort_pending(w);
+    return status;
+}
+
+/// @brief Subscribes to the events of a directory and every directory below it
+/// @param w Watcher
+/// @param root_path Directory to watch
+/// @param must_exist Whether failing to watch root_path itself is an error, rather than a directory that is already gone
+/// @return 0 on success, -1 with an exception set on error
+int watcher_add_tree(HashWatcher* w, const char* root_path, bool must_exist) {
+    StackNode* stack = NULL;
+    if (push(&stack, root_path) != 0) { PyErr_NoMemory(); return -1; }
+
+    while (stack != NULL) {
+        char* path = pop(&stack);
+
+        int wd = inotify_add_watch(w->fd, path, WATCH_EVENTS);
+        if (wd < 0) {
+            // Out of watches leaves part of the tree unwatched, so the manifest would silently go stale
+            if (errno == ENOSPC) {
+                PyErr_Format(PyExc_OSError, "Error watching directory: %s: out of inotify watches, raise fs.inotify.max_user_watches", path);
+            } else if (errno == ENOMEM || (must_exist && strcmp(path, root_path) == 0)) {
+                PyErr_SetFromErrnoWithFilename(PyExc_OSError, path);
+            } else {
+                fprintf(stderr, "Error watching directory: %s: %s\n", path, strerror(errno));
+                free(path);
+                continue;
+            }
+            free(path);
+            free_stack(&stack);
+            return -1;
+        }
+
+        if ((size_t)wd >= w->watch_capacity) {
+            size_t capacity = w->watch_capacity ? w->watch_capacity : FILES_TO_STORE;
+            while (capacity <= (size_t)wd) capacity *= 2;
+            char** resized = realloc(w->watch_paths, sizeof(char*) * capacity);
+            if (resized == NULL) { free(path); free_stack(&stack); PyErr_NoMemory(); return -1; }
+            memset(&resized[w->watch_capacity], 0, sizeof(char*) * (capacity - w->watch_capacity));
+            w->watch_paths = resized;
+            w->watch_capacity = capacity;
+        }
+        // A directory moved inside the tree keeps its watch descriptor
+        free(w->watch_paths[wd]);
+        w->watch_paths[wd] = path;
+
+        DIR* d = opendir(path);
+        if (d == NULL) continue;
+
+        struct dirent *dir;
+        while ((dir = readdir(d)) != NULL) {
+            if (dir->d_type == DT_DIR && strcmp(dir->d_name, ".") != 0 && strcmp(dir->d_name, "..") != 0) {
+                char sub_path[PATH_MAX];
+                snprintf(sub_path, sizeof(sub_path), "%s/%s", path, dir->d_name);
+                if (push(&stack, sub_path) != 0) {
+                    closedir(d);
+                    free_stack(&stack);
+                    PyErr_NoMemory();
+                    return -1;
+                }
+            }
+        }
+        closedir(d);
+    }
+    return 0;
+}
+
+/// @brief Stops watching a directory that left the tree, along with everything below it
+/// @param w Watcher
+/// @param dir Directory that was moved away
+void watcher_remove_tree(HashWatcher* w, const char* dir) {
+    size_t len = strlen(dir);
+    for (size_t wd = 0; wd < w->watch_capacity; ++wd) {
+        const char* path = w->watch_paths[wd];
+        // The path is released once IN_IGNORED for the descriptor arrives
+        if (path != NULL && strncmp(path, dir, len) == 0 && (path[len] == '\0' || path[len] == '/'))
+            inotify_rm_watch(w->fd, wd);
+    }
+}
+
+/// @brief Hashes every scheduled file whose deadline has passed and updates the index
+/// @param w Watcher
+/// @param now Current time, INFINITY to hash everything that is scheduled
+/// @return Number of files rehashed, -1 on error
+ssize_t watcher_rehash(HashWatcher* w, double now) {
+    HashingDirectory due = { .num_files = 0, .files = malloc(sizeof(char*) * (w->num_pending + 1)) };
+    CHECK_ALLOC(due.files, -1);
+
+    size_t kept = 0;
+    for (size_t i = 0; i < w->num_pending; ++i) {
+        if (w->pending[i].due <= now) due.files[due.num_files++] = w->pending[i].path;
+        else w->pending[kept++] = w->pending[i];
+    }
+    w->num_pending = kept;
+
+    if (due.num_files == 0) { free(due.files); return 0; }
+
+    const char* hashes;
+    Py_BEGIN_ALLOW_THREADS
+        pool_lock(w->pool);
+        hashes = hash_files(w->pool, &due);
+    Py_END_ALLOW_THREADS
+    int status = 0;
+    if (hashes == NULL) { PyErr_NoMemory(); status = -1; }
+    for (size_t i = 0; i < due.num_files; ++i) {
+        if (status == 0) {
+            // The file was removed or replaced before we got to it
+            if (hashes[i * HASH_STR_SIZE] == '\0') manifest_remove(&w->index, due.files[i]);
+            else status = manifest_set(&w->index, due.files[i], &hashes[i * HASH_STR_SIZE]);
+        }
+        free(due.files[i]);
+    }
+    pool_unlock(w->pool);
+    free(due.files);
+
+    w->dirty = true;
+    return status == 0 ? (ssize_t)due.num_files : -1;
+}
+
+/// @brief Applies a single inotify event to the watcher
+/// @param w Watcher
+/// @param ev Event to apply
+/// @param now Current time
+/// @return 0 on success, -1 on error
+int watcher_handle_event(HashWatcher* w, const struct inotify_event* ev, double now) {
+    if (ev->mask & IN_Q_OVERFLOW) {
+        // Events were dropped, so nothing in the index can be trusted anymore
+        fprintf(stderr, "Event queue overflowed, rehashing %s\n", w->root_path);
+        manifest_free(&w->index);
+        w->dirty = true;
+        // Directories created while events were being dropped aren't watched yet
+        if (watcher_add_tree(w, w->root_path, true) != 0) return -1;
+        return watcher_queue_tree(w, w->root_path, now);
+    }
+    if (ev->wd < 0 || (size_t)ev->wd >= w->watch_capacity || w->watch_paths[ev->wd] == NULL) return 0;
+    if (ev->mask & IN_IGNORED) {
+        free(w->watch_paths[ev->wd]);
+        w->watch_paths[ev->wd] = NULL;
+        return 0;
+    }
+    if (ev->len == 0) return 0;
+
+    char* path = malloc(strlen(w->watch_paths[ev->wd]) + strlen(ev->name) + 2);
+    CHECK_ALLOC(path, -1);
+    sprintf(path, "%s/%s", w->watch_paths[ev->wd], ev->name);
+
+    int status = 0;
+    if (ev->mask & IN_ISDIR) {
+        if (ev->mask & (IN_CREATE | IN_MOVED_TO)) {
+            // Files can be written into a new directory before it is watched, so walk it as well
+            status = watcher_add_tree(w, path, false);
+            if (status == 0) status = watcher_queue_tree(w, path, now + WATCH_DEBOUNCE_MS / 1000.0);
+        } else if (ev->mask & (IN_DELETE | IN_MOVED_FROM)) {
+            if (ev->mask & IN_MOVED_FROM) watcher_remove_tree(w, path);
+            watcher_unqueue(w, path, true);
+            ssize_t removed = manifest_remove_dir(&w->index, path);
+            if (removed < 0) status = -1;
+            else if (removed > 0) w->dirty = true;
+        }
+    } else if (!is_excluded_path(path) && !watcher_is_manifest(w, path)) {
+        // Hard links and mknod create a file without ever writing it. Only regular files
+        // are hashed, like get_filenames does, as opening a FIFO would block
+        struct stat st;
+        bool added = (ev->mask & (IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE)) != 0;
+        if (added && lstat(path, &st) == 0 && S_ISREG(st.st_mode)) {
+            status = watcher_queue(w, path, now + WATCH_DEBOUNCE_MS / 1000.0);
+        } else if (added || (ev->mask & (IN_DELETE | IN_MOVED_FROM))) {
+            watcher_unqueue(w, path, false);
+            if (manifest_remove(&w->index, path)) w->dirty = true;
+        }
+    }
+
+    free(path);
+    return status;
+}
+
+/// @brief Picks the mtime of a flushed manifest, so that watcher_seed rehashes every file whose
+///        latest write might be missing from it: files still waiting to settle, and anything
+///        written after the events were last read
+/// @param w Watcher
+/// @return Time the hashes in the index are known to be current at
+struct timespec watcher_manifest_stamp(const HashWatcher* w) {
+    struct timespec stamp = w->drained;
+    for (size_t i = 0; i < w->num_pending; ++i) {
+        struct stat st;
+        if (stat(w->pending[i].path, &st) == 0 && timespec_before(st.st_ctim, stamp)) stamp = st.st_ctim;
+    }
+    return stamp;
+}
+
+/// @brief Fills the index from the existing manifest, scheduling files that are new or changed since it was written
+/// @param w Watcher
+/// @return 0 on success, -1 on error
+int watcher_seed(HashWatcher* w) {
+    Manifest previous = {0};
+    struct stat manifest_stat;
+    bool have_manifest = stat(w->out_file, &manifest_stat) == 0;
+    if (have_manifest && manifest_load(&previous, w->out_file) != 0) return -1;
+
+    HashingDirectory* files = get_filenames(w->root_path);
+    if (files == NULL) { manifest_free(&previous); PyErr_NoMemory(); return -1; }
+
+    int status = 0;
+    for (size_t i = 0; i < files->num_files; ++i) {
+        char* path = files->files[i];
+        size_t pos;
+        struct stat st;
+        if (status != 0 || is_excluded_path(path) || watcher_is_manifest(w, path)) {
+            // Skipped
+        // cp -p, rsync -t and tar can set mtime back, but not ctime
+        } else if (have_manifest && manifest_find(&previous, path, &pos) && stat(path, &st) == 0
+                   && timespec_before(st.st_mtim, manifest_stat.st_mtim) && timespec_before(st.st_ctim, manifest_stat.st_mtim)) {
+            ManifestEntry* entry = manifest_insert_at(&w->index, w->index.num_entries);
+            if (entry == NULL) status = -1;
+            else { entry->path = path; memcpy(entry->hash, previous.entries[pos].hash, HASH_STR_SIZE); continue; }
+        } else {
+            status = watcher_insert_pending(w, w->num_pending, path, 0.0);
+        }
+        free(path);
+    }
+    free(files->files);
+    free(files);
+    manifest_free(&previous);
+
+    watcher_sort_pending(w);
+    qsort(w->index.entries, w->index.num_entries, sizeof(ManifestEntry), compare_manifest_entries);
+    w->dirty = true;
+    return status;
+}
+
+void watcher_free(HashWatcher* w) {
+    if (w->fd >= 0) close(w->fd);
+    for (size_t wd = 0; wd < w->watch_capacity; ++wd)
+        free(w->watch_paths[wd]);
+    free(w->watch_paths);
+    for (size_t i = 0; i < w->num_pending; ++i)
+        free(w->pending[i].path);
+    free(w->pending);
+    manifest_free(&w->index);
+}
+
+/// @brief Keeps the SHA256 file of a directory up to date, rehashing files as they are written
+/// @param pool Pool to hash with
+/// @param path Directory to watch recursively
+/// @param out_file File to seed the hashes from and to write them to
+/// @param flush_interval Minimum number of seconds between two writes of out_file
+/// @param duration Number of seconds to watch for, 0 to watch until interrupted
+/// @return Number of files rehashed, -1 on error
+ssize_t C_watch_hashes(HashingPool* pool, char* path, char* out_file, double flush_interval, double duration) {
+    HashWatcher w = { .fd = -1, .pool = pool, .root_path = path, .out_file = out_file };
+
+    const char* slash = strrchr(out_file, '/');
+    char out_dir[PATH_MAX];
+    snprintf(out_dir, sizeof(out_dir), "%.*s", slash ? (int)(slash - out_file) : 1, slash ? out_file : ".");
+    w.manifest_name = slash ? slash + 1 : out_file;
+    if (realpath(out_dir, w.manifest_dir) == NULL) { PyErr_SetFromErrnoWithFilename(PyExc_OSError, out_dir); return -1; }
+
+    w.fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (w.fd < 0) { PyErr_SetFromErrno(PyExc_OSError); return -1; }
+
+    // Subscribe before walking, so that nothing written during the walk is missed
+    ssize_t rehashed = -1;
+    if (watcher_add_tree(&w, path, true) != 0 || watcher_seed(&w) != 0) goto cleanup;
+    if ((rehashed = watcher_rehash(&w, INFINITY)) < 0) goto cleanup;
+
+    double start = monotonic_seconds();
+    double last_flush = -INFINITY;
+    _Alignas(struct inotify_event) char events[WATCH_EVENT_BUFFER];
+    struct pollfd pfd = { .fd = w.fd, .events = POLLIN };
+
+    while (true) {
+        int ready;
+        Py_BEGIN_ALLOW_THREADS
+            ready = poll(&pfd, 1, WATCH_POLL_INTERVAL_MS);
+        Py_END_ALLOW_THREADS
+        if (ready < 0 && errno != EINTR) { PyErr_SetFromErrno(PyExc_OSError); rehashed = -1; break; }
+        if (PyErr_CheckSignals() != 0) break;
+
+        double now = monotonic_seconds();
+        w.drained = file_clock_now();
+        ssize_t len;
+        int status = 0;
+        while (status == 0 && (len = read(w.fd, events, sizeof(events))) > 0) {
+            for (char* p = events; status == 0 && p < events + len; p += sizeof(struct inotify_event) + ((struct inotify_event*)p)->len)
+                status = watcher_handle_event(&w, (struct inotify_event*)p, now);
+        }
+        if (status != 0) { rehashed = -1; break; }
+
+        ssize_t count = watcher_rehash(&w, now);
+        if (count < 0) { rehashed = -1; break; }
+        rehashed += count;
+
+        if (w.dirty && now - last_flush >= flush_interval) {
+            if (manifest_flush(&w.index, out_file, watcher_manifest_stamp(&w)) != 0) {
+                PyErr_SetFromErrnoWithFilename(PyExc_OSError, out_file);
+                rehashed = -1;
+                break;
+            }
+            w.dirty = false;
+            last_flush = now;
+        }
+
+        if (duration > 0 && now - start >= duration) break;
+    }
+
+    // Don't lose anything that was already seen, even when interrupted
+    if (rehashed >= 0) {
+        ssize_t count = watcher_rehash(&w, INFINITY);
+        if (count >= 0 && rehashed >= 0) rehashed += count;
+        if (w.dirty && manifest_flush(&w.index, out_file, watcher_manifest_stamp(&w)) != 0 && !PyErr_Occurred())
+            PyErr_SetFromErrnoWithFilename(PyExc_OSError, out_file);
+        if (PyErr_Occurred()) rehashed = -1;
+    }
+
+cleanup:
+    watcher_free(&w);
+    return rehashed;
+}
+// --------------------------------------
+#else
+ssize_t C_watch_hashes(HashingPool* pool, char* path, char* out_file, double flush_interval, double duration) {
+    PyErr_SetString(PyExc_NotImplementedError, "Watch mode needs inotify, which is only available on Linux");
+    return -1;
+}
+#endif
+
 // Python bindings
-static PyObject* hash_file(PyObject* self, PyObject* args) {
+// Hashing entry points are shared by the module level functions, which use the default pool, and Pool methods
+static PyObject* do_hash_file(HashingPool* pool, PyObject* args) {
     const char* filename;
     if (!PyArg_ParseTuple(args, "s", &filename)) return NULL;
-    FILE* fp = fopen(filename, "r");
-    if (fp == NULL) { PyErr_SetFromErrno(PyExc_OSError); return NULL; }
-    sha256_ctx ctx;
-    sha256_init(&ctx);
-    C_hash_file(fp, &ctx);
-    fclose(fp);
-    char hash_str[SHA256_DIGEST_SIZE * 2 + 1];
-    convert_hash_to_str(ctx.block, hash_str);
+    char hash_str[HASH_STR_SIZE];
+    int status;
+    Py_BEGIN_ALLOW_THREADS
+        pool_lock(pool);
+        status = pool_hash_file(pool, filename, hash_str);
+        pool_unlock(pool);
+    Py_END_ALLOW_THREADS
+    if (status != 0) return PyErr_SetFromErrnoWithFilename(PyExc_OSError, filename);
     return Py_BuildValue("s", hash_str);
 }
-static PyObject* check_hashes_against_file(PyObject* self, PyObject* args) {
+static PyObject* do_hash_files(HashingPool* pool, PyObject* args) {
+    PyObject* filename_list;
+    if (!PyArg_ParseTuple(args, "O", &filename_list)) return NULL;
+
+    PyObject* filenames = PySequence_Fast(filename_list, "filenames must be a sequence of filenames");
+    if (filenames == NULL) return NULL;
+    HashingDirectory dir = { .num_files = PySequence_Fast_GET_SIZE(filenames) };
+    dir.files = malloc(sizeof(char*) * (dir.num_files + 1));
+    if (dir.files == NULL) { Py_DECREF(filenames); return PyErr_NoMemory(); }
+
+    for (size_t i = 0; i < dir.num_files; ++i) {
+        dir.files[i] = (char*)PyUnicode_AsUTF8(PySequence_Fast_GET_ITEM(filenames, i));
+        if (dir.files[i] == NULL) { free(dir.files); Py_DECREF(filenames); return NULL; }
+    }
+
+    const char* hashes;
+    Py_BEGIN_ALLOW_THREADS
+        pool_lock(pool);
+        hashes = hash_files(pool, &dir);
+    Py_END_ALLOW_THREADS
+    PyObject* result = hashes ? PyList_New(dir.num_files) : PyErr_NoMemory();
+    for (size_t i = 0; result != NULL && i < dir.num_files; ++i) {
+        const char* hash_str = &hashes[i * HASH_STR_SIZE];
+        PyObject* item = Py_None;
+        if (hash_str[0] != '\0') item = PyUnicode_FromString(hash_str);
+        else Py_INCREF(Py_None);
+        if (item == NULL) Py_CLEAR(result);
+        else PyList_SET_ITEM(result, i, item);
+    }
+    pool_unlock(pool);
+
+    free(dir.files);
+    Py_DECREF(filenames);
+    return result;
+}
+/// @brief Validates the shard arguments of a binding, raising ValueError if they are out of range
+int check_shard(Py_ssize_t shard_index, Py_ssize_t shard_count) {
+    if (shard_count < 1 || shard_index < 0 || shard_index >= shard_count) {
+        PyErr_Format(PyExc_ValueError, "shard_index must be in [0, shard_count), got %zd of %zd", shard_index, shard_count);
+        return -1;
+    }
+    return 0;
+}
+static PyObject* do_check_hashes_against_file(HashingPool* pool, PyObject* args) {
     const char* hash_list_filename;
-    if (!PyArg_ParseTuple(args, "s", &hash_list_filename)) return NULL;
-    return PyLong_FromSize_t(C_check_hashes_against_file(hash_list_filename));
+    Py_ssize_t shard_index = 0, shard_count = 1;
+    if (!PyArg_ParseTuple(args, "s|nn", &hash_list_filename, &shard_index, &shard_count)) return NULL;
+    if (check_shard(shard_index, shard_count) != 0) return NULL;
+    size_t mismatched_hashes = C_check_hashes_against_file(pool, hash_list_filename, shard_index, shard_count);
+    if (mismatched_hashes == (size_t)-1) return NULL;
+    return PyLong_FromSize_t(mismatched_hashes);
+}
+static PyObject* do_regenerate_hashes(HashingPool* pool, PyObject* args) {
+    char* path; char* out_file;
+    Py_ssize_t shard_index = 0, shard_count = 1;
+    if (!PyArg_ParseTuple(args, "ss|nn", &path, &out_file, &shard_index, &shard_count)) return NULL;
+    if (check_shard(shard_index, shard_count) != 0) return NULL;
 
+    // A full tree can take hours, so walk, hash and write without the GIL
+    int status, saved_errno;
+    Py_BEGIN_ALLOW_THREADS
+        pool_lock(pool);
+        status = C_regenerate_hashes(pool, path, out_file, shard_index, shard_count);
+        saved_errno = errno;
+        pool_unlock(pool);
+    Py_END_ALLOW_THREADS
+    if (status != 0) {
+        errno = saved_errno;
+        return errno == ENOMEM ? PyErr_NoMemory() : PyErr_SetFromErrnoWithFilename(PyExc_OSError, out_file);
+    }
+    Py_INCREF(Py_None); return Py_None;
+}
+static PyObject* do_watch_hashes(HashingPool* pool, PyObject* args) {
+    char* path; char* out_file;
+    double flush_interval = WATCH_FLUSH_INTERVAL; double duration = 0.0;
+    if (!PyArg_ParseTuple(args, "ss|dd", &path, &out_file, &flush_interval, &duration)) return NULL;
+    ssize_t rehashed = C_watch_hashes(pool, path, out_file, flush_interval, duration);
+    if (rehashed < 0) return NULL;
+    return PyLong_FromSsize_t(rehashed);
+}
+
+static PyObject* hash_file(PyObject* self, PyObject* args) {
+    HashingPool* pool = get_default_pool();
+    return pool ? do_hash_file(pool, args) : NULL;
+}
+static PyObject* check_hashes_against_file(PyObject* self, PyObject* args) {
+    HashingPool* pool = get_default_pool();
+    return pool ? do_check_hashes_against_file(pool, args) : NULL;
 }
 static PyObject* regenerate_hashes(PyObject* self, PyObject* args) {
+    HashingPool* pool = get_default_pool();
+    return pool ? do_regenerate_hashes(pool, args) : NULL;
+}
+static PyObject* merge_manifests(PyObject* self, PyObject* args) {
+    PyObject* partial_list; char* out_file;
+    if (!PyArg_ParseTuple(args, "Os", &partial_list, &out_file)) return NULL;
+
+    PyObject* partials = PySequence_Fast(partial_list, "partial_files must be a sequence of filenames");
+    if (partials == NULL) return NULL;
+    Py_ssize_t num_partials = PySequence_Fast_GET_SIZE(partials);
+    char** partial_files = malloc(sizeof(char*) * (num_partials + 1));
+    if (partial_files == NULL) { Py_DECREF(partials); return PyErr_NoMemory(); }
+
+    for (Py_ssize_t i = 0; i < num_partials; ++i) {
+        partial_files[i] = (char*)PyUnicode_AsUTF8(PySequence_Fast_GET_ITEM(partials, i));
+        if (partial_files[i] == NULL) { free(partial_files); Py_DECREF(partials); return NULL; }
+    }
+
+    // The partial manifests can be as large as the tree, so merge without the GIL
+    ssize_t written;
+    size_t failed_file;
+    int saved_errno;
     Py_BEGIN_ALLOW_THREADS
-        char* path; char* out_file;
-        if (!PyArg_ParseTuple(args, "ss", &path, &out_file)) return NULL;
-        C_regenerate_hashes(path, out_file);
-        Py_INCREF(Py_None); return Py_None;
+        written = C_merge_manifests(partial_files, num_partials, out_file, &failed_file);
+        saved_errno = errno;
     Py_END_ALLOW_THREADS
+    if (written == -2) {
+        PyErr_Format(PyExc_ValueError, "%s is not sorted", partial_files[failed_file]);
+    } else if (written < 0) {
+        errno = saved_errno;
+        if (errno == ENOMEM) PyErr_NoMemory();
+        else PyErr_SetFromErrnoWithFilename(PyExc_OSError, failed_file < (size_t)num_partials ? partial_files[failed_file] : out_file);
+    }
+    free(partial_files);
+    Py_DECREF(partials);
+    if (written < 0) return NULL;
+    return PyLong_FromSsize_t(written);
 }
 static PyObject* get_hash_from_file(PyObject* self, PyObject* args) {
     char* file_to_hash; char* sha_file;
     if (!PyArg_ParseTuple(args, "ss", &file_to_hash, &sha_file)) return NULL;
     return Py_BuildValue("s", C_get_hash_from_file(file_to_hash, sha_file));
 }
+static PyObject* watch_hashes(PyObject* self, PyObject* args) {
+    HashingPool* pool = get_default_pool();
+    return pool ? do_watch_hashes(pool, args) : NULL;
+}
 static PyObject* version(PyObject* self) {
     return Py_BuildValue("s", "0.0.5");
 }
 // ---------------
 
+// Pool type
+/// @brief Gets the pool of a Pool object, raising ValueError if it was closed
+HashingPool* pool_of(PyObject* self) {
+    HashingPool* pool = ((PoolObject*)self)->pool;
+    if (pool == NULL) PyErr_SetString(PyExc_ValueError, "Pool is closed");
+    return pool;
+}
+static int Pool_init(PoolObject* self, PyObject* args, PyObject* kwds) {
+    static char* kwlist[] = {"threads", NULL};
+    int num_threads = PARALLEL_PROCESSES;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|i", kwlist, &num_threads)) return -1;
+    if (num_threads < 1) { PyErr_SetString(PyExc_ValueError, "threads must be at least 1"); return -1; }
+    if (self->busy > 0) { PyErr_SetString(PyExc_RuntimeError, "Pool is in use"); return -1; }
+
+    pool_destroy(self->pool);
+    self->pool = pool_create(num_threads);
+    return self->pool ? 0 : -1;
+}
+static void Pool_dealloc(PoolObject* self) {
+    pool_destroy(self->pool);
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+static PyObject* Pool_close(PyObject* self, PyObject* Py_UNUSED(ignored)) {
+    // Calls that released the GIL, like watch_hashes, still use the pool
+    if (((PoolObject*)self)->busy > 0) { PyErr_SetString(PyExc_RuntimeError, "Pool is in use"); return NULL; }
+    pool_destroy(((PoolObject*)self)->pool);
+    ((PoolObject*)self)->pool = NULL;
+    Py_RETURN_NONE;
+}
+static PyObject* Pool_enter(PyObject* self, PyObject* Py_UNUSED(ignored)) {
+    Py_INCREF(self);
+    return self;
+}
+static PyObject* Pool_exit(PyObject* self, PyObject* args) {
+    return Pool_close(self, NULL);
+}
+static PyObject* Pool_hash_file(PyObject* self, PyObject* args) {
+    HashingPool* pool = pool_of(self);
+    if (pool == NULL) return NULL;
+    ((PoolObject*)self)->busy++;
+    PyObject* result = do_hash_file(pool, args);
+    ((PoolObject*)self)->busy--;
+    return result;
+}
+static PyObject* Pool_hash_files(PyObject* self, PyObject* args) {
+    HashingPool* pool = pool_of(self);
+    if (pool == NULL) return NULL;
+    ((PoolObject*)self)->busy++;
+    PyObject* result = do_hash_files(pool, args);
+    ((PoolObject*)self)->busy--;
+    return result;
+}
+static PyObject* Pool_check_hashes_against_file(PyObject* self, PyObject* args) {
+    HashingPool* pool = pool_of(self);
+    if (pool == NULL) return NULL;
+    ((PoolObject*)self)->busy++;
+    PyObject* result = do_check_hashes_against_file(pool, args);
+    ((PoolObject*)self)->busy--;
+    return result;
+}
+static PyObject* Pool_regenerate_hashes(PyObject* self, PyObject* args) {
+    HashingPool* pool = pool_of(self);
+    if (pool == NULL) return NULL;
+    ((PoolObject*)self)->busy++;
+    PyObject* result = do_regenerate_hashes(pool, args);
+    ((PoolObject*)self)->busy--;
+    return result;
+}
+static PyObject* Pool_watch_hashes(PyObject* self, PyObject* args) {
+    HashingPool* pool = pool_of(self);
+    if (pool == NULL) return NULL;
+    ((PoolObject*)self)->busy++;
+    PyObject* result = do_watch_hashes(pool, args);
+    ((PoolObject*)self)->busy--;
+    return result;
+}
+static PyObject* Pool_get_threads(PyObject* self, void* closure) {
+    HashingPool* pool = pool_of(self);
+    return pool ? PyLong_FromLong(pool->num_threads) : NULL;
+}
+// ---------------
+
+static PyMethodDef PoolMethods[] = {
+    {"hash_file", Pool_hash_file, METH_VARARGS, "Get the SHA256 hash of the file specified"},
+    {"hash_files", Pool_hash_files, METH_VARARGS, "Get the SHA256 hashes of the files specified, None for files that could not be read"},
+    {"check_hashes_against_file", Pool_check_hashes_against_file, METH_VARARGS, "Check all files in the file specified, or those of one shard, against corresponding SHA256 hashes, returns the number of mismatched hashes"},
+    {"regenerate_hashes", Pool_regenerate_hashes, METH_VARARGS, "Regenerate SHA256 hashes for all files in the directory specified, or those of one shard, writing the sorted results to the specified file"},
+    {"watch_hashes", Pool_watch_hashes, METH_VARARGS, "Keep the SHA256 hashes of the directory specified up to date in the specified file, rehashing files as they are written"},
+    {"close", Pool_close, METH_NOARGS, "Free the buffers of the pool, it can't be used afterwards"},
+    {"__enter__", Pool_enter, METH_NOARGS, NULL},
+    {"__exit__", Pool_exit, METH_VARARGS, NULL},
+    {NULL, NULL, 0, NULL}
+};
+
+static PyGetSetDef PoolGetSet[] = {
+    {"threads", Pool_get_threads, NULL, "Number of threads the pool hashes with", NULL},
+    {NULL, NULL, NULL, NULL, NULL}
+};
+
+static PyTypeObject PoolType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "bulkhasher.Pool",
+    .tp_doc = "Hashing workers with buffers that are reused across calls",
+    .tp_basicsize = sizeof(PoolObject),
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_new = PyType_GenericNew,
+    .tp_init = (initproc)Pool_init,
+    .tp_dealloc = (destructor)Pool_dealloc,
+    .tp_methods = PoolMethods,
+    .tp_getset = PoolGetSet,
+};
+
 static PyMethodDef HashMethods[] = {
     {"hash_file", (PyCFunction)hash_file, METH_VARARGS, "Get the SHA256 hash of the file specified"},
-    {"check_hashes_against_file", (PyCFunction)check_hashes_against_file, METH_VARARGS, "Check all files in the file specified against corresponding SHA256 hashes, returns the number of mismatched hashes"},
-    {"regenerate_hashes", (PyCFunction)regenerate_hashes, METH_VARARGS, "Regenerate SHA256 hashes for all files in the directory specified, writing the results to the specified file"},
+    {"check_hashes_against_file", (PyCFunction)check_hashes_against_file, METH_VARARGS, "Check all files in the file specified, or those of one shard, against corresponding SHA256 hashes, returns the number of mismatched hashes"},
+    {"regenerate_hashes", (PyCFunction)regenerate_hashes, METH_VARARGS, "Regenerate SHA256 hashes for all files in the directory specified, or those of one shard, writing the sorted results to the specified file"},
+    {"merge_manifests", (PyCFunction)merge_manifests, METH_VARARGS, "Merge sorted SHA256 files, such as the ones written by each shard of regenerate_hashes, into the specified file"},
     {"get_hash_from_file", (PyCFunction)get_hash_from_file, METH_VARARGS, "Get the SHA256 hash of the file specified in the sha256 file"},
+    {"watch_hashes", (PyCFunction)watch_hashes, METH_VARARGS, "Keep the SHA256 hashes of the directory specified up to date in the specified file, rehashing files as they are written"},
     {"version", (PyCFunction)version, METH_NOARGS, "Get the version of the program"},
     {NULL, NULL, 0, NULL}
 };
 
 static struct PyModuleDef bulkhashermodule = {
     PyModuleDef_HEAD_INIT,
-    "hash",
+    "bulkhasher",
     "SHA256 hashing module",
     -1,
     HashMethods,
@@ -384,5 +1588,16 @@ static struct PyModuleDef bulkhashermodule = {
 };
 
 PyMODINIT_FUNC PyInit_bulkhasher() {
-    return PyModule_Create(&bulkhashermodule);
+    if (PyType_Ready(&PoolType) < 0) return NULL;
+
+    PyObject* module = PyModule_Create(&bulkhashermodule);
+    if (module == NULL) return NULL;
+
+    Py_INCREF(&PoolType);
+    if (PyModule_AddObject(module, "Pool", (PyObject*)&PoolType) < 0) {
+        Py_DECREF(&PoolType);
+        Py_DECREF(module);
+        return NULL;
+    }
+    return module;
 }
\ No newline at end of file
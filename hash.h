@@ -1,37 +1,136 @@
 #ifndef HASH_H
 #define HASH_H
 
-#define BUFFER_SIZE  16384 // 16 KiB buffer for reading files
+#include <limits.h>
+#include <stdbool.h>
+#include <time.h>
+
+#define POOL_BUFFER_SIZE 262144 // 256 KiB buffer per pool worker, allocated once
+#define POOL_BUFFER_ALIGNMENT 4096 // Page aligned, so reads go straight into it
 #define FILES_TO_STORE 256 // Maximum number of files to store in memory
 #define READ_BUFFER   4096 // Read at most 4 KiB per line
 
 #define PARALLEL_PROCESSES 16
 
+#define HASH_STR_SIZE (SHA256_DIGEST_SIZE * 2 + 1)
+#define MANIFEST_SEPARATOR " = "
+#define MANIFEST_TMP_SUFFIX ".tmp" // Manifests are written here first, then renamed over
+
+#define WATCH_FLUSH_INTERVAL   5.0 // Default number of seconds between two manifest writes
+#define WATCH_DEBOUNCE_MS      200 // Wait this long after the last write to a file before rehashing it
+#define WATCH_POLL_INTERVAL_MS 100 // Wake up at least this often to rehash, flush and check for signals
+#define WATCH_EVENT_BUFFER   65536 // Read at most 64 KiB of inotify events at once
+#define WATCH_EVENTS (IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE | IN_ONLYDIR | IN_EXCL_UNLINK)
+
 typedef struct HashingDirectory {
     size_t num_files;
     char** files;
 } HashingDirectory;
 
+typedef struct HashingWorker {
+    unsigned char* buffer;
+    sha256_ctx ctx;
+} HashingWorker;
+
+// State reused by every call that hashes with the pool
+typedef struct HashingPool {
+    int num_threads;
+    HashingWorker* workers; // One per thread
+    omp_lock_t lock; // Serializes error messages of the workers
+    PyThread_type_lock busy; // Held by the call that is hashing with the pool
+    char* results;
+    size_t results_capacity;
+} HashingPool;
+
 typedef struct StackNode {
     char* path;
     struct StackNode* next;
 } StackNode;
 
+typedef struct ManifestEntry {
+    char* path;
+    char hash[HASH_STR_SIZE];
+} ManifestEntry;
+
+// Entries are kept sorted by path
+typedef struct Manifest {
+    size_t num_entries;
+    size_t capacity;
+    ManifestEntry* entries;
+} Manifest;
+
+// Position in one of the partial manifests being merged
+typedef struct MergeCursor {
+    FILE* fp;
+    size_t index;
+    char* path;
+    char* hash;
+    char line[READ_BUFFER];
+} MergeCursor;
+
+typedef struct PendingFile {
+    char* path;
+    double due;
+} PendingFile;
+
+typedef struct HashWatcher {
+    int fd;
+    char** watch_paths; // Directory of each watch descriptor
+    size_t watch_capacity;
+    HashingPool* pool;
+    PendingFile* pending; // Files written to that are waiting to settle, sorted by path
+    size_t num_pending;
+    size_t pending_capacity;
+    Manifest index;
+    bool dirty;
+    struct timespec drained; // When the events were last read
+    char* root_path;
+    const char* out_file;
+    const char* manifest_name;
+    char manifest_dir[PATH_MAX];
+} HashWatcher;
+
+typedef struct PoolObject {
+    PyObject_HEAD
+    HashingPool* pool;
+    Py_ssize_t busy; // Number of method calls using the pool right now
+} PoolObject;
+
 void convert_hash_to_str(unsigned char* hash, char* hash_str);
 
-void C_hash_file(FILE *fp, sha256_ctx *ctx);
-char** hash_files(HashingDirectory* dir);
+int C_hash_fd(int fd, sha256_ctx *ctx, unsigned char* buffer);
+
+HashingPool* pool_create(int num_threads);
+void pool_destroy(HashingPool* pool);
+void pool_lock(HashingPool* pool);
+void pool_unlock(HashingPool* pool);
+int pool_hash_file(HashingPool* pool, const char* filename, char* hash_str);
+const char* hash_files(HashingPool* pool, HashingDirectory* dir);
 
 HashingDirectory* get_filenames(char* root_path);
 
-void C_regenerate_hashes(char* path, char* out_file);
-size_t C_check_hashes_against_file(const char* hash_list_filename);
+size_t shard_of_path(const char* path, size_t shard_count);
+
+int C_regenerate_hashes(HashingPool* pool, char* path, char* out_file, size_t shard_index, size_t shard_count);
+size_t C_check_hashes_against_file(HashingPool* pool, const char* hash_list_filename, size_t shard_index, size_t shard_count);
+ssize_t C_merge_manifests(char** partial_files, size_t num_partial_files, const char* out_file, size_t* failed_file);
 char* C_get_hash_from_file(char* file_to_hash, char* sha_file);
 
+struct timespec file_clock_now(void);
+int split_manifest_line(char* line, char** filename, char** stored_hash);
+int compare_manifest_entries(const void* a, const void* b);
+int manifest_load(Manifest* manifest, const char* filename);
+int manifest_flush(const Manifest* manifest, const char* out_file, struct timespec stamp);
+void manifest_free(Manifest* manifest);
+
+ssize_t C_watch_hashes(HashingPool* pool, char* path, char* out_file, double flush_interval, double duration);
+
 static PyObject* hash_file(PyObject* self, PyObject* args);
 static PyObject* check_hashes_against_file(PyObject* self, PyObject* args);
 static PyObject* regenerate_hashes(PyObject* self, PyObject* args);
+static PyObject* merge_manifests(PyObject* self, PyObject* args);
 static PyObject* get_hash_from_file(PyObject* self, PyObject* args);
+static PyObject* watch_hashes(PyObject* self, PyObject* args);
 static PyObject* version(PyObject* self);
 
 #endif // HASH_H
\ No newline at end of file
@@ -8,17 +8,13 @@ int main(void) {
     char* hs = C_get_hash_from_file("assets/hubert/hubert_base.pt", "SHA256");
     printf("%s\n", hs);
 
-    FILE* fp = fopen("assets/hubert/hubert_base.pt", "r");
-    sha256_ctx ctx;
-    sha256_init(&ctx);
-    C_hash_file(fp, &ctx);
-
-    fclose(fp);
-    char hash_str[SHA256_DIGEST_SIZE * 2 + 1];
-    convert_hash_to_str(ctx.block, hash_str);
+    HashingPool* pool = pool_create(PARALLEL_PROCESSES);
+    char hash_str[HASH_STR_SIZE];
+    pool_hash_file(pool, "assets/hubert/hubert_base.pt", hash_str);
 
     printf("%s\n", hash_str);
 
-    C_regenerate_hashes("assets", "SHA256");
+    C_regenerate_hashes(pool, "assets", "SHA256", 0, 1);
+    pool_destroy(pool);
     return 0;
 }
\ No newline at end of file
@@ -1,7 +1,58 @@
+import multiprocessing
+import os
+import shutil
+import threading
+import time
 import bulkhasher
 
-print(bulkhasher.version())
+if __name__ == "__main__":
+    print(bulkhasher.version())
 
-print(bulkhasher.hash_file("build/bulkhasher.so"))
+    print(bulkhasher.hash_file("build/bulkhasher.so"))
 
-bulkhasher.regenerate_hashes("assets", "SHA256")
\ No newline at end of file
+    bulkhasher.regenerate_hashes("assets", "SHA256")
+
+    # OpenMP does not survive fork, so shard processes have to be spawned
+    SHARDS = 4
+    with multiprocessing.get_context("spawn").Pool(SHARDS) as pool:
+        pool.starmap(bulkhasher.regenerate_hashes, [("assets", f"SHA256.{i}", i, SHARDS) for i in range(SHARDS)])
+
+    bulkhasher.merge_manifests([f"SHA256.{i}" for i in range(SHARDS)], "SHA256.merged")
+    assert open("SHA256.merged").read() == open("SHA256").read()
+
+    with bulkhasher.Pool(4) as pool:
+        assert pool.hash_files(["build/bulkhasher.so"]) == [bulkhasher.hash_file("build/bulkhasher.so")]
+        assert pool.check_hashes_against_file("SHA256") == 0
+
+    # Files that disappeared since the hashes were generated fail verification
+    open("assets/deleted_file", "w").write("deleted")
+    bulkhasher.regenerate_hashes("assets", "SHA256.deleted")
+    os.remove("assets/deleted_file")
+    assert bulkhasher.check_hashes_against_file("SHA256.deleted") == 1
+
+    # The watcher picks up new files, hard links, new directories and deletions, and writes the same manifest as regenerate_hashes
+    shutil.rmtree("watched", ignore_errors=True)
+    os.makedirs("watched")
+    open("watched/kept", "w").write("kept")
+    open("watched/deleted", "w").write("deleted")
+
+    def change_watched_tree():
+        time.sleep(0.5)
+        open("watched/created", "w").write("created")
+        os.makedirs("watched/nested/deeper")
+        open("watched/nested/deeper/file", "w").write("nested")
+        os.link("watched/kept", "watched/nested/linked")
+        os.remove("watched/deleted")
+
+    writer = threading.Thread(target=change_watched_tree)
+    writer.start()
+    bulkhasher.watch_hashes("watched", "SHA256.watched", 0.2, 2.0)
+    writer.join()
+
+    watched = open("SHA256.watched").read()
+    assert "watched/created = " in watched and "watched/nested/deeper/file = " in watched
+    assert "watched/nested/linked = " in watched
+    assert "watched/deleted" not in watched
+    bulkhasher.regenerate_hashes("watched", "SHA256.expected")
+    assert watched == open("SHA256.expected").read()
+    shutil.rmtree("watched")
\ No newline at end of file